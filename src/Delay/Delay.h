@@ -4,12 +4,16 @@
 #include <math.h>
 #include <vector>
 #include "DelayLine.h"
+#include "DelayKernels.h"
 
 template <typename Type, size_t maxNumChannels=2>
 class Delay {
     public:
+        enum class DuckDetector { peak, rms };
+
         Delay() {
             setMaxDelayTime(2.f); 
+            loopResumeGains.fill(Type(1));
             std::printf("Delay Lines: %ld\n", delayLines.size());
             std::printf("Delay Time Samples: %ld\n", delayTimesSample.size());
             std::printf("Delay Time: %ld\n", delayTimes.size());
@@ -22,12 +26,31 @@ class Delay {
             for (auto& delayLine : delayLines) {
                 delayLine.clear();
             }
+            std::fill(fadeSamplesRemaining.begin(), fadeSamplesRemaining.end(), 0);
+            std::fill(releaseSamplesRemaining.begin(), releaseSamplesRemaining.end(), 0);
+            duckGain = Type(1);
+            frozen = false;
         }
         void prepare(const juce::dsp::ProcessSpec& spec) {
             jassert(spec.numChannels < maxNumChannels);
             sampleRate = (Type)spec.sampleRate;
+            kernels = &selectDelayKernels<Type>();
+            delayedBlock.resize(spec.maximumBlockSize);
+            feedbackBlock.resize(spec.maximumBlockSize);
             updateDelayLineSize();
             updateDelayTime();
+            updateCrossfadeLength();
+            //No transition on a fresh start, the read heads land where they should.
+            delayTimesSample = targetDelayTimesSample;
+            std::fill(fadeSamplesRemaining.begin(), fadeSamplesRemaining.end(), 0);
+            //Loop buffers were just resized, a held freeze is captured again on the next block.
+            //resize() moved the write position without touching the samples, so clear the
+            //lines or that capture would loop misaligned leftovers.
+            std::fill(releaseSamplesRemaining.begin(), releaseSamplesRemaining.end(), 0);
+            frozen = false;
+            for (auto& delayLine : delayLines) {
+                delayLine.clear();
+            }
             filterCoefs = juce::dsp::IIR::Coefficients<Type>::makeFirstOrderHighPass (sampleRate, Type(1e3));
             for (auto& filter : filters) {
                 filter.prepare(spec);
@@ -37,9 +60,16 @@ class Delay {
             std::printf("Delay Lines: %ld\n", delayLines.size());
             std::printf("Delay Time Samples: %ld\n", delayTimesSample.size());
             std::printf("Delay Time: %ld\n", delayTimes.size());
+            DBG("DSP Kernels: " << kernels->name);
         }
+        //Ducking keyed by the dry input.
         template <typename ProcessContext>
         void process(const ProcessContext& context) noexcept {
+            process(context, context.getInputBlock());
+        }
+        //Ducking keyed by keyBlock, e.g. a sidechain bus.
+        template <typename ProcessContext, typename KeyBlock>
+        void process(const ProcessContext& context, const KeyBlock& keyBlock) noexcept {
             auto& inputBlock = context.getInputBlock();
             auto& outputBlock = context.getOutputBlock();
             auto numChannels = outputBlock.getNumChannels();
@@ -47,23 +77,100 @@ class Delay {
 
             jassert(inputBlock.getNumSamples() == numSamples);
             jassert(inputBlock.getNumChannels() == numChannels);
+            jassert(keyBlock.getNumSamples() == numSamples);
+
+            //Duck gain moves once per block, the wet level ramps across it. The key is read
+            //before any output is written since it may be the input block itself.
+            auto wetStart = wetLevel * duckGain;
+            auto wetStep = Type(0);
+            if (numSamples > 0 && (duckAmount > Type(0) || duckGain != Type(1))) {
+                updateDuckGain(keyBlock, numSamples);
+                wetStep = (wetLevel * duckGain - wetStart) / (Type)numSamples;
+            }
+
+            if (freezeRequested != frozen) {
+                frozen = freezeRequested;
+                for (size_t ch = 0; ch < numChannels; ++ch) {
+                    if (frozen && releaseSamplesRemaining[ch] > 0) {
+                        //Re-frozen mid release: the line was just cleared, so keep the loop
+                        //that is still fading out and bring it back up over this block.
+                        loopResumeGains[ch] = (Type)releaseSamplesRemaining[ch] / (Type)loopFadeSamples[ch];
+                        releaseSamplesRemaining[ch] = 0;
+                    }
+                    else if (frozen) {
+                        captureLoop(ch);
+                    }
+                    else {
+                        //The line still holds pre-freeze repeats that would seam against the
+                        //live input, so start from silence and fade the loop out instead.
+                        //This also covers any time jump made while frozen.
+                        delayLines[ch].clear();
+                        filters[ch].reset();
+                        releaseSamplesRemaining[ch] = loopFadeSamples[ch];
+                        delayTimesSample[ch] = targetDelayTimesSample[ch];
+                        fadeSamplesRemaining[ch] = 0;
+                    }
+                }
+            }
 
             //run through the channels
             for (size_t ch = 0; ch < numChannels; ++ch) {
                 auto* input = inputBlock.getChannelPointer(ch);
                 auto* output = outputBlock.getChannelPointer(ch);
+                if (frozen) {
+                    //Ends on the same wet gain as the block's own ramp.
+                    auto loopStart = wetStart * loopResumeGains[ch];
+                    auto loopStep = numSamples > 0 ? wetStep + (wetStart - loopStart) / (Type)numSamples : wetStep;
+                    loopResumeGains[ch] = Type(1);
+                    playLoop(ch, input, output, numSamples, loopStart, loopStep);
+                    continue;
+                }
                 auto& dline = delayLines[ch];
-                auto delayTime = delayTimesSample[ch];
                 auto& filter = filters[ch];
+                size_t sample = 0;
+                //After a freeze, fade the held loop out of the output and the live input into
+                //the line. The loop stays out of the write path, a short fragment of it would
+                //otherwise recirculate with a hard onset on every repeat.
+                if (releaseSamplesRemaining[ch] > 0) {
+                    auto& remaining = releaseSamplesRemaining[ch];
+                    auto releaseStep = Type(1) / (Type)loopFadeSamples[ch];
+                    for (; sample < numSamples && remaining > 0; ++sample, --remaining) {
+                        auto loopGain = (Type)remaining * releaseStep;
+                        auto lineSample = filter.processSample(dline.get(delayTimesSample[ch]));
+                        auto inputSample = input[sample];
+                        dline.push(std::atan((Type(1) - loopGain) * inputSample + feedbackLevel * lineSample));
+                        auto delayedSample = lineSample + loopGain * (nextLoopSample(ch) - lineSample);
+                        output[sample] = std::atan(inputSample + (wetStart + (Type)sample * wetStep) * delayedSample);
+                    }
+                }
+                //Crossfade from the old read head to the new one, only while a jump is pending.
+                //Fades run back to back so a moving target never drops a head mid-mix.
+                while (sample < numSamples && (fadeSamplesRemaining[ch] > 0 || targetDelayTimesSample[ch] != delayTimesSample[ch])) {
+                    if (fadeSamplesRemaining[ch] == 0) {
+                        startFade(ch);
+                        continue;
+                    }
+                    auto newDelayTime = delayTimesSample[ch];
+                    auto previousDelayTime = previousDelayTimesSample[ch];
+                    auto& remaining = fadeSamplesRemaining[ch];
+                    auto fadeStep = fadeSteps[ch];
+                    for (; sample < numSamples && remaining > 0; ++sample, --remaining) {
+                        auto oldGain = (Type)remaining * fadeStep;
+                        auto newHead = dline.get(newDelayTime);
+                        auto headSample = newHead + oldGain * (dline.get(previousDelayTime) - newHead);
+                        output[sample] = processSample(input[sample], headSample, wetStart + (Type)sample * wetStep, dline, filter);
+                    }
+                }
+                auto delayTime = delayTimesSample[ch];
+                //Whole block in one go when it doesn't read anything it writes itself.
+                auto remainingSamples = numSamples - sample;
+                if (remainingSamples > 0 && remainingSamples <= delayTime + 1) {
+                    processBlock(input + sample, output + sample, remainingSamples, wetStart + (Type)sample * wetStep, wetStep, delayTime, dline, filter);
+                    continue;
+                }
                 //run through the buffer
-                for (size_t sample = 0; sample < numSamples; ++sample) {
-                   //process magic. 
-                   auto delayedSample = filter.processSample(dline.get(delayTime));
-                   auto inputSample = input[sample];
-                   auto dlineInputSample = std::atan(inputSample + feedbackLevel * delayedSample);
-                   dline.push(dlineInputSample);
-                   auto outputSample = std::atan(inputSample + wetLevel * delayedSample);
-                   output[sample] = outputSample;
+                for (; sample < numSamples; ++sample) {
+                   output[sample] = processSample(input[sample], dline.get(delayTime), wetStart + (Type)sample * wetStep, dline, filter);
                 }
             }
         }
@@ -89,30 +196,228 @@ class Delay {
             sampleRate = sampleRate_;
         }
 
+        //Length of the read head crossfade when the delay time jumps, 0 jumps instantly.
+        void setCrossfadeTime(Type crossfadeTime_) {
+            crossfadeTime = crossfadeTime_;
+            updateCrossfadeLength();
+        }
+
+        //Ducking of the repeats, an amount of 0 turns it off.
+        void setDuckThreshold(Type thresholdDb) {
+            duckThreshold = juce::Decibels::decibelsToGain(thresholdDb);
+        }
+
+        void setDuckAmount(Type duckAmount_) {
+            duckAmount = duckAmount_;
+        }
+
+        void setDuckAttackTime(Type duckAttackTime_) {
+            duckAttackTime = duckAttackTime_;
+        }
+
+        void setDuckReleaseTime(Type duckReleaseTime_) {
+            duckReleaseTime = duckReleaseTime_;
+        }
+
+        void setDuckDetector(DuckDetector duckDetector_) {
+            duckDetector = duckDetector_;
+        }
+
+        //Holds the current repeat as a loop, picked up at the start of the next block.
+        void setFreeze(bool freeze) {
+            freezeRequested = freeze;
+        }
+
         //Ancillary Functions
         void updateDelayLineSize() {
             auto delayLineSamples = (size_t)std::ceil(maxDelayTime * sampleRate);
             for (auto& delayLine : delayLines) {
                 delayLine.resize(delayLineSamples);
             }
+            for (auto& loopBuffer : loopBuffers) {
+                loopBuffer.resize(delayLineSamples);
+            }
         }
 
         void updateDelayTime() noexcept {
             for (size_t ch = 0; ch < maxNumChannels; ++ch) {
-                delayTimesSample[ch] = (size_t) juce::roundToInt(delayTimes[ch] * sampleRate); 
+                //Picked up by process once any running fade has finished. Tempo sync can ask
+                //for more than maxDelayTime, so keep the head inside the line.
+                auto newDelayTimeSample = (size_t) juce::roundToInt(delayTimes[ch] * sampleRate); 
+                targetDelayTimesSample[ch] = std::min(newDelayTimeSample, delayLines[ch].size() - 1);
             }
         }
+
+        void updateCrossfadeLength() noexcept {
+            crossfadeSamples = (size_t) juce::roundToInt(crossfadeTime * sampleRate);
+        }
     private:
+        //Moves the read head to the latest target, crossfading unless the fade is off.
+        //A head of 0 was never set (times arrive after prepare), so there is nothing to fade from.
+        void startFade(size_t ch) noexcept {
+            if (crossfadeSamples == 0 || delayTimesSample[ch] == 0) {
+                delayTimesSample[ch] = targetDelayTimesSample[ch];
+                return;
+            }
+            previousDelayTimesSample[ch] = delayTimesSample[ch];
+            delayTimesSample[ch] = targetDelayTimesSample[ch];
+            fadeSamplesRemaining[ch] = crossfadeSamples;
+            //Fixed for the whole fade, the crossfade time may change before it ends.
+            fadeSteps[ch] = Type(1) / (Type)crossfadeSamples;
+        }
+
+        //Per-sample filter, feedback and saturation shared by both read paths.
+        Type processSample(Type inputSample, Type headSample, Type wetGain, DelayLine<Type>& dline, juce::dsp::IIR::Filter<Type>& filter) noexcept {
+            auto delayedSample = filter.processSample(headSample);
+            auto dlineInputSample = std::atan(inputSample + feedbackLevel * delayedSample);
+            dline.push(dlineInputSample);
+            return std::atan(inputSample + wetGain * delayedSample);
+        }
+
+        //Block version of processSample, only the filter recursion stays per sample.
+        void processBlock(const Type* input, Type* output, size_t numSamples, Type wetStart, Type wetStep, size_t delayTime, DelayLine<Type>& dline, juce::dsp::IIR::Filter<Type>& filter) noexcept {
+            jassert(numSamples <= delayedBlock.size());
+            auto* delayed = delayedBlock.data();
+            auto* feedback = feedbackBlock.data();
+            dline.readBlock(delayTime, delayed, numSamples, *kernels);
+            for (size_t sample = 0; sample < numSamples; ++sample) {
+                delayed[sample] = filter.processSample(delayed[sample]);
+            }
+            kernels->mix(feedback, input, delayed, feedbackLevel, numSamples);
+            kernels->saturate(feedback, numSamples);
+            dline.writeBlock(feedback, numSamples, *kernels);
+            //Output last, it may share memory with the input.
+            kernels->mixRamp(output, input, delayed, wetStart, wetStep, numSamples);
+            kernels->saturate(output, numSamples);
+        }
+
+        //Copies the current repeat out of the delay line with a short pre-roll, filters it once
+        //and bakes the pre-roll into the loop tail so the wrap is seamless. Playback after this
+        //is reads only, so the loop never drifts. Starts where the running delay would read next.
+        void captureLoop(size_t ch) noexcept {
+            auto& dline = delayLines[ch];
+            auto& filter = filters[ch];
+            auto* loop = loopBuffers[ch].data();
+            //Pre-roll plus loop must fit in both the line and the loop buffer.
+            jassert(loopBuffers[ch].size() == dline.size());
+            auto length = std::min(delayTimesSample[ch] + 1, dline.size());
+            auto fadeLength = std::min({std::max(crossfadeSamples, minLoopFadeSamples), length / 2, dline.size() - length});
+            dline.readBlock(length - 1 + fadeLength, loop, length + fadeLength, *kernels);
+            //The pre-roll also settles the filter before the loop proper.
+            filter.reset();
+            for (size_t sample = 0; sample < length + fadeLength; ++sample) {
+                loop[sample] = filter.processSample(loop[sample]);
+            }
+            for (size_t sample = 0; sample < fadeLength; ++sample) {
+                auto preRollGain = (Type)sample / (Type)fadeLength;
+                auto& tail = loop[length + sample];
+                tail += preRollGain * (loop[sample] - tail);
+            }
+            loopStarts[ch] = fadeLength;
+            loopLengths[ch] = length;
+            loopPositions[ch] = 0;
+            loopFadeSamples[ch] = fadeLength;
+            releaseSamplesRemaining[ch] = 0;
+        }
+
+        Type nextLoopSample(size_t ch) noexcept {
+            auto& position = loopPositions[ch];
+            auto value = loopBuffers[ch][loopStarts[ch] + position];
+            position = position + 1 == loopLengths[ch] ? 0 : position + 1;
+            return value;
+        }
+
+        //Frozen block: no filter, no feedback and no delay line writes.
+        void playLoop(size_t ch, const Type* input, Type* output, size_t numSamples, Type wetStart, Type wetStep) noexcept {
+            jassert(numSamples <= delayedBlock.size());
+            auto* delayed = delayedBlock.data();
+            auto* loop = loopBuffers[ch].data() + loopStarts[ch];
+            auto length = loopLengths[ch];
+            auto& position = loopPositions[ch];
+            for (size_t done = 0; done < numSamples;) {
+                auto chunk = std::min(numSamples - done, length - position);
+                kernels->copy(delayed + done, loop + position, chunk);
+                position = position + chunk == length ? 0 : position + chunk;
+                done += chunk;
+            }
+            kernels->mixRamp(output, input, delayed, wetStart, wetStep, numSamples);
+            //Output shaping stays so the dry level doesn't jump when freezing.
+            kernels->saturate(output, numSamples);
+        }
+
+        //Block rate follower: measure the key, then glide the gain towards the ducked or open
+        //level with the attack/release time constant. One exp per block, none per sample.
+        template <typename KeyBlock>
+        void updateDuckGain(const KeyBlock& keyBlock, size_t numSamples) noexcept {
+            auto target = Type(1);
+            auto numKeyChannels = keyBlock.getNumChannels();
+            if (duckAmount > Type(0) && numKeyChannels > 0) {
+                auto peak = Type(0);
+                auto sumOfSquares = Type(0);
+                for (size_t ch = 0; ch < numKeyChannels; ++ch) {
+                    Type channelPeak, channelSum;
+                    kernels->measure(keyBlock.getChannelPointer(ch), numSamples, channelPeak, channelSum);
+                    peak = std::max(peak, channelPeak);
+                    sumOfSquares += channelSum;
+                }
+                auto level = duckDetector == DuckDetector::peak
+                           ? peak
+                           : std::sqrt(sumOfSquares / (Type)(numKeyChannels * numSamples));
+                if (level > duckThreshold) {
+                    target = Type(1) - duckAmount;
+                }
+            }
+            auto timeConstant = target < duckGain ? duckAttackTime : duckReleaseTime;
+            auto coef = std::exp(-(Type)numSamples / (std::max(timeConstant, Type(1e-4)) * sampleRate));
+            duckGain = target + coef * (duckGain - target);
+            //Settle so an idle ducker drops out of the block entirely.
+            if (std::abs(duckGain - target) < Type(1e-5)) {
+                duckGain = target;
+            }
+        }
+
         //Variables
         Type maxDelayTime {Type(2)};
         Type wetLevel {Type(0)};
         Type feedbackLevel {Type(0)};
         Type sampleRate {Type(44.1e3)};
+        Type crossfadeTime {Type(0)};
+        size_t crossfadeSamples {0};
+        //Ducking
+        Type duckThreshold {Type(0.063)};
+        Type duckAmount {Type(0)};
+        Type duckAttackTime {Type(0.01)};
+        Type duckReleaseTime {Type(0.25)};
+        Type duckGain {Type(1)};
+        DuckDetector duckDetector {DuckDetector::peak};
+        //Freeze, the loop points always get a short fade even with the time crossfade off.
+        static constexpr size_t minLoopFadeSamples {32};
+        bool freezeRequested {false};
+        bool frozen {false};
         //Containers
         std::array<DelayLine<Type>, maxNumChannels> delayLines;
-        std::array<size_t, maxNumChannels> delayTimesSample;
+        //Read head in use, and the one it is heading for once the current fade ends.
+        std::array<size_t, maxNumChannels> delayTimesSample {};
+        std::array<size_t, maxNumChannels> targetDelayTimesSample {};
+        //Read head being faded out, only valid while fadeSamplesRemaining is non-zero.
+        std::array<size_t, maxNumChannels> previousDelayTimesSample {};
+        std::array<size_t, maxNumChannels> fadeSamplesRemaining {};
+        std::array<Type, maxNumChannels> fadeSteps {};
         //For each channel, what are the corresponding delays.
-        std::array<Type, maxNumChannels> delayTimes;
+        std::array<Type, maxNumChannels> delayTimes {};
+        //Scratch for the block path, sized to the host block in prepare.
+        std::vector<Type> delayedBlock;
+        std::vector<Type> feedbackBlock;
+        const DelayKernels<Type>* kernels {nullptr};
+        //Held loop per channel, sized with the delay lines. loopStarts skips the pre-roll.
+        std::array<std::vector<Type>, maxNumChannels> loopBuffers;
+        std::array<size_t, maxNumChannels> loopStarts {};
+        std::array<size_t, maxNumChannels> loopLengths {};
+        std::array<size_t, maxNumChannels> loopPositions {};
+        std::array<size_t, maxNumChannels> loopFadeSamples {};
+        std::array<size_t, maxNumChannels> releaseSamplesRemaining {};
+        //Loop level to ramp up from when freeze returns during a release.
+        std::array<Type, maxNumChannels> loopResumeGains;
         //Effects
         std::array<juce::dsp::IIR::Filter<Type>, maxNumChannels> filters;
         typename juce::dsp::IIR::Coefficients<Type>::Ptr filterCoefs;
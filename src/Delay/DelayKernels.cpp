@@ -0,0 +1,87 @@
+#include <JuceHeader.h>
+#include "DelayKernels.h"
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <cpuid.h>
+ #endif
+#endif
+
+namespace {
+    enum class KernelLevel { sse2, avx2, avx512 };
+
+    //XCR0 bits: SSE and AVX state, plus the opmask and upper ZMM state for AVX-512.
+    constexpr unsigned long long avxStateMask = 0x6;
+    constexpr unsigned long long avx512StateMask = 0xe6;
+
+    //CPUID only reports what the CPU has, the OS must also save the wider registers
+    //on context switches. That is what XGETBV tells us, once OSXSAVE says it may be used.
+    bool osSavesRegisterState(unsigned long long mask) {
+       #if JUCE_INTEL
+        unsigned int ecx = 0;
+        #if JUCE_MSVC
+        int info[4];
+        __cpuid(info, 1);
+        ecx = (unsigned int)info[2];
+        #else
+        unsigned int eax = 0, ebx = 0, edx = 0;
+        if (! __get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        #endif
+        if ((ecx & (1u << 27)) == 0) {
+            return false;
+        }
+        #if JUCE_MSVC
+        auto xcr0 = (unsigned long long)_xgetbv(0);
+        #else
+        unsigned int xcr0Low = 0, xcr0High = 0;
+        __asm__ volatile ("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+        auto xcr0 = ((unsigned long long)xcr0High << 32) | xcr0Low;
+        #endif
+        return (xcr0 & mask) == mask;
+       #else
+        juce::ignoreUnused(mask);
+        return false;
+       #endif
+    }
+
+    //Both wide tables are built with -mfma, so FMA3 is required alongside them.
+    KernelLevel detectKernelLevel() {
+        auto hasFMA = juce::SystemStats::hasFMA3();
+        if (juce::SystemStats::hasAVX512F() && hasFMA && osSavesRegisterState(avx512StateMask)) {
+            return KernelLevel::avx512;
+        }
+        if (juce::SystemStats::hasAVX2() && hasFMA && osSavesRegisterState(avxStateMask)) {
+            return KernelLevel::avx2;
+        }
+        return KernelLevel::sse2;
+    }
+
+    //The override can only lower the level, forcing AVX-512 on a CPU without it would crash.
+    KernelLevel selectKernelLevel() {
+        auto level = detectKernelLevel();
+        auto forced = juce::SystemStats::getEnvironmentVariable("BREWS_DELAY_SIMD", {});
+        if (forced.equalsIgnoreCase("sse2")) {
+            return KernelLevel::sse2;
+        }
+        if (forced.equalsIgnoreCase("avx2") && level != KernelLevel::sse2) {
+            return KernelLevel::avx2;
+        }
+        return level;
+    }
+}
+
+template <typename Type>
+const DelayKernels<Type>& selectDelayKernels() {
+    switch (selectKernelLevel()) {
+        case KernelLevel::avx512: return getDelayKernelsAVX512<Type>();
+        case KernelLevel::avx2: return getDelayKernelsAVX2<Type>();
+        case KernelLevel::sse2: break;
+    }
+    return getDelayKernelsSSE2<Type>();
+}
+
+template const DelayKernels<float>& selectDelayKernels<float>();
+template const DelayKernels<double>& selectDelayKernels<double>();
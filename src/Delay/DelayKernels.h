@@ -0,0 +1,34 @@
+#pragma once
+#include <stdlib.h>
+
+//Block kernels used by Delay, built once per instruction set and picked at prepare time.
+//Kept free of JUCE so the per-ISA translation units don't emit JUCE inline code with wider flags.
+template <typename Type>
+struct DelayKernels {
+    const char* name;
+    //dest[i] = src[i]
+    void (*copy)(Type* dest, const Type* src, size_t numSamples) noexcept;
+    //dest[i] = a[i] + gain * b[i], dest may alias a.
+    void (*mix)(Type* dest, const Type* a, const Type* b, Type gain, size_t numSamples) noexcept;
+    //dest[i] = a[i] + (startGain + i * gainStep) * b[i], dest may alias a.
+    void (*mixRamp)(Type* dest, const Type* a, const Type* b, Type startGain, Type gainStep, size_t numSamples) noexcept;
+    //Largest |data[i]| and sum of data[i]^2 over the block.
+    void (*measure)(const Type* data, size_t numSamples, Type& peak, Type& sumOfSquares) noexcept;
+    //data[i] = atan(data[i]), accurate to float precision.
+    void (*saturate)(Type* data, size_t numSamples) noexcept;
+};
+
+//One table per instruction set, see DelayKernelsSSE2.cpp etc.
+template <typename Type> const DelayKernels<Type>& getDelayKernelsSSE2() noexcept;
+template <typename Type> const DelayKernels<Type>& getDelayKernelsAVX2() noexcept;
+template <typename Type> const DelayKernels<Type>& getDelayKernelsAVX512() noexcept;
+//Each is an explicit specialization defined in its own file, declared here before any use.
+template <> const DelayKernels<float>& getDelayKernelsSSE2<float>() noexcept;
+template <> const DelayKernels<double>& getDelayKernelsSSE2<double>() noexcept;
+template <> const DelayKernels<float>& getDelayKernelsAVX2<float>() noexcept;
+template <> const DelayKernels<double>& getDelayKernelsAVX2<double>() noexcept;
+template <> const DelayKernels<float>& getDelayKernelsAVX512<float>() noexcept;
+template <> const DelayKernels<double>& getDelayKernelsAVX512<double>() noexcept;
+
+//Best table the running CPU supports, BREWS_DELAY_SIMD=sse2|avx2|avx512 forces a lower one.
+template <typename Type> const DelayKernels<Type>& selectDelayKernels();
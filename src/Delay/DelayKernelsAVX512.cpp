@@ -0,0 +1,4 @@
+//Built with the AVX512 flags set in CMakeLists.txt.
+#include "DelayKernelsImpl.h"
+
+BREWS_DEFINE_DELAY_KERNELS(AVX512)
@@ -0,0 +1,270 @@
+#pragma once
+#include "DelayKernels.h"
+
+//Widest x86 vector set this translation unit is built for, from the compiler's own macros.
+#if defined(__AVX512F__)
+ #define BREWS_KERNEL_VECTORS 512
+#elif defined(__AVX2__)
+ #define BREWS_KERNEL_VECTORS 256
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #define BREWS_KERNEL_VECTORS 128
+#else
+ #define BREWS_KERNEL_VECTORS 0
+#endif
+#if BREWS_KERNEL_VECTORS
+ #include <immintrin.h>
+#endif
+
+//Included once by each per-ISA translation unit. Everything lives in an anonymous namespace
+//and avoids std:: inline helpers so no wide-ISA copy of a shared inline function can leak
+//into the rest of the plugin at link time. The plain loops are branch free so the compiler
+//vectorizes them for whatever -m/arch flags the including file is built with, saturation
+//uses explicit register ops.
+namespace {
+   #if BREWS_KERNEL_VECTORS == 512
+    template <typename Type> struct VectorOps;
+    template <> struct VectorOps<float> {
+        using Vector = __m512;
+        using Mask = __mmask16;
+        static constexpr size_t width = 16;
+        static Vector load(const float* p) noexcept { return _mm512_loadu_ps(p); }
+        static void store(float* p, Vector v) noexcept { _mm512_storeu_ps(p, v); }
+        static Vector set(float v) noexcept { return _mm512_set1_ps(v); }
+        static Vector add(Vector a, Vector b) noexcept { return _mm512_add_ps(a, b); }
+        static Vector sub(Vector a, Vector b) noexcept { return _mm512_sub_ps(a, b); }
+        static Vector mul(Vector a, Vector b) noexcept { return _mm512_mul_ps(a, b); }
+        static Vector div(Vector a, Vector b) noexcept { return _mm512_div_ps(a, b); }
+        //_mm512_max_ps trips a false -Wmaybe-uninitialized in GCC 12's headers.
+        static Vector max(Vector a, Vector b) noexcept { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, b, _CMP_GT_OQ), b, a); }
+        static Mask greater(Vector a, Vector b) noexcept { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+        static Vector select(Mask m, Vector a, Vector b) noexcept { return _mm512_mask_blend_ps(m, b, a); }
+        //Float logic ops need AVX512DQ, the integer ones only need F.
+        static Vector signBits(Vector v) noexcept { return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(v), _mm512_set1_epi32((int)0x80000000))); }
+        static Vector flipSign(Vector v, Vector s) noexcept { return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(v), _mm512_castps_si512(s))); }
+    };
+    template <> struct VectorOps<double> {
+        using Vector = __m512d;
+        using Mask = __mmask8;
+        static constexpr size_t width = 8;
+        static Vector load(const double* p) noexcept { return _mm512_loadu_pd(p); }
+        static void store(double* p, Vector v) noexcept { _mm512_storeu_pd(p, v); }
+        static Vector set(double v) noexcept { return _mm512_set1_pd(v); }
+        static Vector add(Vector a, Vector b) noexcept { return _mm512_add_pd(a, b); }
+        static Vector sub(Vector a, Vector b) noexcept { return _mm512_sub_pd(a, b); }
+        static Vector mul(Vector a, Vector b) noexcept { return _mm512_mul_pd(a, b); }
+        static Vector div(Vector a, Vector b) noexcept { return _mm512_div_pd(a, b); }
+        static Vector max(Vector a, Vector b) noexcept { return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(a, b, _CMP_GT_OQ), b, a); }
+        static Mask greater(Vector a, Vector b) noexcept { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+        static Vector select(Mask m, Vector a, Vector b) noexcept { return _mm512_mask_blend_pd(m, b, a); }
+        static Vector signBits(Vector v) noexcept { return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(v), _mm512_set1_epi64((long long)0x8000000000000000ull))); }
+        static Vector flipSign(Vector v, Vector s) noexcept { return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(v), _mm512_castpd_si512(s))); }
+    };
+   #elif BREWS_KERNEL_VECTORS == 256
+    template <typename Type> struct VectorOps;
+    template <> struct VectorOps<float> {
+        using Vector = __m256;
+        using Mask = __m256;
+        static constexpr size_t width = 8;
+        static Vector load(const float* p) noexcept { return _mm256_loadu_ps(p); }
+        static void store(float* p, Vector v) noexcept { _mm256_storeu_ps(p, v); }
+        static Vector set(float v) noexcept { return _mm256_set1_ps(v); }
+        static Vector add(Vector a, Vector b) noexcept { return _mm256_add_ps(a, b); }
+        static Vector sub(Vector a, Vector b) noexcept { return _mm256_sub_ps(a, b); }
+        static Vector mul(Vector a, Vector b) noexcept { return _mm256_mul_ps(a, b); }
+        static Vector div(Vector a, Vector b) noexcept { return _mm256_div_ps(a, b); }
+        static Vector max(Vector a, Vector b) noexcept { return _mm256_max_ps(a, b); }
+        static Mask greater(Vector a, Vector b) noexcept { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static Vector select(Mask m, Vector a, Vector b) noexcept { return _mm256_blendv_ps(b, a, m); }
+        static Vector signBits(Vector v) noexcept { return _mm256_and_ps(v, _mm256_set1_ps(-0.f)); }
+        static Vector flipSign(Vector v, Vector s) noexcept { return _mm256_xor_ps(v, s); }
+    };
+    template <> struct VectorOps<double> {
+        using Vector = __m256d;
+        using Mask = __m256d;
+        static constexpr size_t width = 4;
+        static Vector load(const double* p) noexcept { return _mm256_loadu_pd(p); }
+        static void store(double* p, Vector v) noexcept { _mm256_storeu_pd(p, v); }
+        static Vector set(double v) noexcept { return _mm256_set1_pd(v); }
+        static Vector add(Vector a, Vector b) noexcept { return _mm256_add_pd(a, b); }
+        static Vector sub(Vector a, Vector b) noexcept { return _mm256_sub_pd(a, b); }
+        static Vector mul(Vector a, Vector b) noexcept { return _mm256_mul_pd(a, b); }
+        static Vector div(Vector a, Vector b) noexcept { return _mm256_div_pd(a, b); }
+        static Vector max(Vector a, Vector b) noexcept { return _mm256_max_pd(a, b); }
+        static Mask greater(Vector a, Vector b) noexcept { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+        static Vector select(Mask m, Vector a, Vector b) noexcept { return _mm256_blendv_pd(b, a, m); }
+        static Vector signBits(Vector v) noexcept { return _mm256_and_pd(v, _mm256_set1_pd(-0.0)); }
+        static Vector flipSign(Vector v, Vector s) noexcept { return _mm256_xor_pd(v, s); }
+    };
+   #elif BREWS_KERNEL_VECTORS == 128
+    template <typename Type> struct VectorOps;
+    template <> struct VectorOps<float> {
+        using Vector = __m128;
+        using Mask = __m128;
+        static constexpr size_t width = 4;
+        static Vector load(const float* p) noexcept { return _mm_loadu_ps(p); }
+        static void store(float* p, Vector v) noexcept { _mm_storeu_ps(p, v); }
+        static Vector set(float v) noexcept { return _mm_set1_ps(v); }
+        static Vector add(Vector a, Vector b) noexcept { return _mm_add_ps(a, b); }
+        static Vector sub(Vector a, Vector b) noexcept { return _mm_sub_ps(a, b); }
+        static Vector mul(Vector a, Vector b) noexcept { return _mm_mul_ps(a, b); }
+        static Vector div(Vector a, Vector b) noexcept { return _mm_div_ps(a, b); }
+        static Vector max(Vector a, Vector b) noexcept { return _mm_max_ps(a, b); }
+        static Mask greater(Vector a, Vector b) noexcept { return _mm_cmpgt_ps(a, b); }
+        //No blendv before SSE4.1.
+        static Vector select(Mask m, Vector a, Vector b) noexcept { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+        static Vector signBits(Vector v) noexcept { return _mm_and_ps(v, _mm_set1_ps(-0.f)); }
+        static Vector flipSign(Vector v, Vector s) noexcept { return _mm_xor_ps(v, s); }
+    };
+    template <> struct VectorOps<double> {
+        using Vector = __m128d;
+        using Mask = __m128d;
+        static constexpr size_t width = 2;
+        static Vector load(const double* p) noexcept { return _mm_loadu_pd(p); }
+        static void store(double* p, Vector v) noexcept { _mm_storeu_pd(p, v); }
+        static Vector set(double v) noexcept { return _mm_set1_pd(v); }
+        static Vector add(Vector a, Vector b) noexcept { return _mm_add_pd(a, b); }
+        static Vector sub(Vector a, Vector b) noexcept { return _mm_sub_pd(a, b); }
+        static Vector mul(Vector a, Vector b) noexcept { return _mm_mul_pd(a, b); }
+        static Vector div(Vector a, Vector b) noexcept { return _mm_div_pd(a, b); }
+        static Vector max(Vector a, Vector b) noexcept { return _mm_max_pd(a, b); }
+        static Mask greater(Vector a, Vector b) noexcept { return _mm_cmpgt_pd(a, b); }
+        static Vector select(Mask m, Vector a, Vector b) noexcept { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+        static Vector signBits(Vector v) noexcept { return _mm_and_pd(v, _mm_set1_pd(-0.0)); }
+        static Vector flipSign(Vector v, Vector s) noexcept { return _mm_xor_pd(v, s); }
+    };
+   #endif
+
+    template <typename Type>
+    void copyKernel(Type* dest, const Type* src, size_t numSamples) noexcept {
+        for (size_t i = 0; i < numSamples; ++i) {
+            dest[i] = src[i];
+        }
+    }
+
+    template <typename Type>
+    void mixKernel(Type* dest, const Type* a, const Type* b, Type gain, size_t numSamples) noexcept {
+        for (size_t i = 0; i < numSamples; ++i) {
+            dest[i] = a[i] + gain * b[i];
+        }
+    }
+
+    template <typename Type>
+    void mixRampKernel(Type* dest, const Type* a, const Type* b, Type startGain, Type gainStep, size_t numSamples) noexcept {
+        for (size_t i = 0; i < numSamples; ++i) {
+            dest[i] = a[i] + (startGain + (Type)(int)i * gainStep) * b[i];
+        }
+    }
+
+    //Float reductions don't vectorize without fast-math, so keep one partial result per lane
+    //and let the compiler map the lanes onto vector registers.
+    template <typename Type>
+    void measureKernel(const Type* data, size_t numSamples, Type& peak, Type& sumOfSquares) noexcept {
+        constexpr size_t numLanes = 16;
+        Type lanePeaks[numLanes] = {};
+        Type laneSums[numLanes] = {};
+        size_t i = 0;
+        for (; i + numLanes <= numSamples; i += numLanes) {
+            for (size_t lane = 0; lane < numLanes; ++lane) {
+                auto x = data[i + lane];
+                auto ax = x < Type(0) ? -x : x;
+                lanePeaks[lane] = ax > lanePeaks[lane] ? ax : lanePeaks[lane];
+                laneSums[lane] += x * x;
+            }
+        }
+        for (size_t lane = 0; i < numSamples; ++i, ++lane) {
+            auto x = data[i];
+            auto ax = x < Type(0) ? -x : x;
+            lanePeaks[lane] = ax > lanePeaks[lane] ? ax : lanePeaks[lane];
+            laneSums[lane] += x * x;
+        }
+        peak = Type(0);
+        sumOfSquares = Type(0);
+        for (size_t lane = 0; lane < numLanes; ++lane) {
+            peak = lanePeaks[lane] > peak ? lanePeaks[lane] : peak;
+            sumOfSquares += laneSums[lane];
+        }
+    }
+
+    //Cephes style atan: fold into [0, tan(pi/8)] and run a short odd polynomial.
+    //Scalar form, used for the tail and where there are no vector ops below.
+    template <typename Type>
+    void saturateScalar(Type* data, size_t numSamples) noexcept {
+        const Type tan3PiOver8 = Type(2.414213562373095);
+        const Type tanPiOver8 = Type(0.4142135623730950);
+        const Type halfPi = Type(1.5707963267948966);
+        const Type quarterPi = Type(0.7853981633974483);
+        for (size_t i = 0; i < numSamples; ++i) {
+            auto x = data[i];
+            auto sign = x < Type(0) ? Type(-1) : Type(1);
+            auto ax = sign * x;
+            //Both reductions are computed up front so the selects below stay branch free.
+            auto bigArg = Type(-1) / (ax > Type(1) ? ax : Type(1));
+            auto midArg = (ax - Type(1)) / (ax + Type(1));
+            auto reduced = ax > tanPiOver8 ? midArg : ax;
+            reduced = ax > tan3PiOver8 ? bigArg : reduced;
+            auto offset = ax > tanPiOver8 ? quarterPi : Type(0);
+            offset = ax > tan3PiOver8 ? halfPi : offset;
+            auto z = reduced * reduced;
+            auto poly = (((Type(8.05374449538e-2) * z - Type(1.38776856032e-1)) * z
+                        + Type(1.99777106478e-1)) * z - Type(3.33329491539e-1)) * z * reduced + reduced;
+            data[i] = sign * (offset + poly);
+        }
+    }
+
+   #if BREWS_KERNEL_VECTORS
+    //Same steps as saturateScalar on whole registers. The selects are too much for some
+    //auto-vectorizers (MSVC in particular), so this one is spelled out.
+    template <typename Type, typename Ops>
+    size_t saturateVectors(Type* data, size_t numSamples) noexcept {
+        const auto zero = Ops::set(Type(0));
+        const auto one = Ops::set(Type(1));
+        const auto minusOne = Ops::set(Type(-1));
+        const auto tan3PiOver8 = Ops::set(Type(2.414213562373095));
+        const auto tanPiOver8 = Ops::set(Type(0.4142135623730950));
+        const auto halfPi = Ops::set(Type(1.5707963267948966));
+        const auto quarterPi = Ops::set(Type(0.7853981633974483));
+        const auto c0 = Ops::set(Type(8.05374449538e-2));
+        const auto c1 = Ops::set(Type(1.38776856032e-1));
+        const auto c2 = Ops::set(Type(1.99777106478e-1));
+        const auto c3 = Ops::set(Type(3.33329491539e-1));
+        size_t i = 0;
+        for (; i + Ops::width <= numSamples; i += Ops::width) {
+            auto x = Ops::load(data + i);
+            auto sign = Ops::signBits(x);
+            auto ax = Ops::flipSign(x, sign);
+            auto bigArg = Ops::div(minusOne, Ops::max(ax, one));
+            auto midArg = Ops::div(Ops::sub(ax, one), Ops::add(ax, one));
+            auto isMid = Ops::greater(ax, tanPiOver8);
+            auto isBig = Ops::greater(ax, tan3PiOver8);
+            auto reduced = Ops::select(isBig, bigArg, Ops::select(isMid, midArg, ax));
+            auto offset = Ops::select(isBig, halfPi, Ops::select(isMid, quarterPi, zero));
+            auto z = Ops::mul(reduced, reduced);
+            auto poly = Ops::sub(Ops::mul(c0, z), c1);
+            poly = Ops::add(Ops::mul(poly, z), c2);
+            poly = Ops::sub(Ops::mul(poly, z), c3);
+            poly = Ops::add(Ops::mul(Ops::mul(poly, z), reduced), reduced);
+            Ops::store(data + i, Ops::flipSign(Ops::add(offset, poly), sign));
+        }
+        return i;
+    }
+   #endif
+
+    template <typename Type>
+    void saturateKernel(Type* data, size_t numSamples) noexcept {
+        size_t done = 0;
+       #if BREWS_KERNEL_VECTORS
+        done = saturateVectors<Type, VectorOps<Type>>(data, numSamples);
+       #endif
+        saturateScalar(data + done, numSamples - done);
+    }
+
+    template <typename Type>
+    const DelayKernels<Type>& makeDelayKernels(const char* name) noexcept {
+        static const DelayKernels<Type> kernels {name, &copyKernel<Type>, &mixKernel<Type>, &mixRampKernel<Type>, &measureKernel<Type>, &saturateKernel<Type>};
+        return kernels;
+    }
+}
+
+#define BREWS_DEFINE_DELAY_KERNELS(isa) \
+    template <> const DelayKernels<float>& getDelayKernels##isa<float>() noexcept { return makeDelayKernels<float>(#isa); } \
+    template <> const DelayKernels<double>& getDelayKernels##isa<double>() noexcept { return makeDelayKernels<double>(#isa); }
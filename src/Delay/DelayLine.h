@@ -1,27 +1,45 @@
 #pragma once
 #include <stdlib.h>
 #include <vector>
+#include "DelayKernels.h"
 template <typename Type>
 class DelayLine {
     public:
         DelayLine() {
         }
         void push(Type value) noexcept{
-            rawData[oldestIndex] = value;
-            oldestIndex = oldestIndex == 0 ? size() - 1 : oldestIndex - 1;
+            rawData[writeIndex] = value;
+            writeIndex = writeIndex + 1 == size() ? 0 : writeIndex + 1;
         }
         Type get(size_t delayInSamples) const noexcept {
             jassert(delayInSamples > 0 && delayInSamples < rawData.size());
-            return rawData[(oldestIndex + 1 + delayInSamples) % size()];
+            return rawData[readIndex(delayInSamples)];
         }
         void set(size_t delayInSamples, Type newValue) noexcept{
             jassert(delayInSamples > 0 && delayInSamples < rawData.size());
-            rawData[(oldestIndex + 1 + delayInSamples) % rawData.size()] = newValue;
+            rawData[readIndex(delayInSamples)] = newValue;
+        }
+        //What get(delayInSamples) returns over the next numSamples get/push pairs.
+        //Only valid while none of those samples are written by the block itself.
+        void readBlock(size_t delayInSamples, Type* dest, size_t numSamples, const DelayKernels<Type>& kernels) const noexcept {
+            jassert(numSamples <= delayInSamples + 1 && numSamples <= rawData.size());
+            auto start = readIndex(delayInSamples);
+            auto firstPart = std::min(numSamples, size() - start);
+            kernels.copy(dest, rawData.data() + start, firstPart);
+            kernels.copy(dest + firstPart, rawData.data(), numSamples - firstPart);
+        }
+        //Same as numSamples calls to push.
+        void writeBlock(const Type* src, size_t numSamples, const DelayKernels<Type>& kernels) noexcept {
+            jassert(numSamples <= rawData.size());
+            auto firstPart = std::min(numSamples, size() - writeIndex);
+            kernels.copy(rawData.data() + writeIndex, src, firstPart);
+            kernels.copy(rawData.data(), src + firstPart, numSamples - firstPart);
+            writeIndex = (writeIndex + numSamples) % size();
         }
         void resize(size_t delayInSamples) {
             jassert(delayInSamples > 0 && delayInSamples < rawData.size());
             rawData.resize(delayInSamples);
-            oldestIndex = 0;
+            writeIndex = 0;
         }
         void clear() {
             std::fill(rawData.begin(), rawData.end(), 0); 
@@ -30,7 +48,11 @@ class DelayLine {
             return rawData.size();
         }
     private:
-        size_t oldestIndex;
+        //Newest sample sits just behind the write position.
+        size_t readIndex(size_t delayInSamples) const noexcept {
+            return (writeIndex + size() - 1 - delayInSamples) % size();
+        }
+        size_t writeIndex {0};
         std::vector<Type> rawData;
 };
 
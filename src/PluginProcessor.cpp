@@ -8,6 +8,7 @@ AudioPluginAudioProcessor::AudioPluginAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
@@ -22,6 +23,13 @@ AudioPluginAudioProcessor::AudioPluginAudioProcessor()
     castParameter(apvts, ParameterID::syncToggle, syncToggleParam);
     castParameter(apvts, ParameterID::lSyncRate, lSyncRateParam);
     castParameter(apvts, ParameterID::rSyncRate, rSyncRateParam);
+    castParameter(apvts, ParameterID::crossfadeTime, crossfadeTimeParam);
+    castParameter(apvts, ParameterID::duckThreshold, duckThresholdParam);
+    castParameter(apvts, ParameterID::duckAmount, duckAmountParam);
+    castParameter(apvts, ParameterID::duckAttack, duckAttackParam);
+    castParameter(apvts, ParameterID::duckRelease, duckReleaseParam);
+    castParameter(apvts, ParameterID::duckDetector, duckDetectorParam);
+    castParameter(apvts, ParameterID::freezeToggle, freezeToggleParam);
     apvts.state.addListener(this);
 }
 
@@ -130,6 +138,13 @@ bool AudioPluginAudioProcessor::isBusesLayoutSupported (const BusesLayout& layou
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
+
+    // The ducking sidechain is optional, and mono or stereo when present.
+    auto sidechainSet = layouts.getChannelSet (true, 1);
+    if (! sidechainSet.isDisabled()
+     && sidechainSet != juce::AudioChannelSet::mono()
+     && sidechainSet != juce::AudioChannelSet::stereo())
+        return false;
    #endif
 
     return true;
@@ -157,8 +172,18 @@ void AudioPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
        update(); 
     }
 
-    juce::dsp::AudioBlock<float> block {buffer};
-    delayModule.process(juce::dsp::ProcessContextReplacing<float>{block});
+    //Only the main bus goes through the delay, the sidechain just keys the ducking.
+    auto mainBuffer = getBusBuffer(buffer, false, 0);
+    juce::dsp::AudioBlock<float> block {mainBuffer};
+    juce::dsp::ProcessContextReplacing<float> context {block};
+    auto* sidechainBus = getBus(true, 1);
+    if (sidechainBus != nullptr && sidechainBus->isEnabled() && sidechainBus->getNumberOfChannels() > 0) {
+        auto sidechainBuffer = getBusBuffer(buffer, true, 1);
+        delayModule.process(context, juce::dsp::AudioBlock<float>{sidechainBuffer});
+    }
+    else {
+        delayModule.process(context);
+    }
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout AudioPluginAudioProcessor::createParameterLayout() {
@@ -224,11 +249,60 @@ juce::AudioProcessorValueTreeState::ParameterLayout AudioPluginAudioProcessor::c
                 80,
                 juce::AudioParameterIntAttributes().withLabel("%")
                 ));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+                ParameterID::crossfadeTime,
+                "Time Crossfade",
+                juce::NormalisableRange(0.f,50.f,0.1f),
+                10.f,
+                juce::AudioParameterFloatAttributes().withLabel("ms") 
+                ));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+                ParameterID::duckThreshold,
+                "Duck Threshold",
+                juce::NormalisableRange(-60.f,0.f,0.1f),
+                -24.f,
+                juce::AudioParameterFloatAttributes().withLabel("dB") 
+                ));
+    layout.add(std::make_unique<juce::AudioParameterInt>(
+                ParameterID::duckAmount,
+                "Duck Amount",
+                0,
+                100,
+                0,
+                juce::AudioParameterIntAttributes().withLabel("%")
+                ));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+                ParameterID::duckAttack,
+                "Duck Attack",
+                juce::NormalisableRange(1.f,200.f,0.1f),
+                10.f,
+                juce::AudioParameterFloatAttributes().withLabel("ms") 
+                ));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+                ParameterID::duckRelease,
+                "Duck Release",
+                juce::NormalisableRange(10.f,2000.f,1.f),
+                250.f,
+                juce::AudioParameterFloatAttributes().withLabel("ms") 
+                ));
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+                    ParameterID::duckDetector,
+                    "Duck Detector",
+                    juce::StringArray {"Peak", "RMS"},
+                    0
+                ));
+    layout.add(std::make_unique<juce::AudioParameterBool>(
+                ParameterID::freezeToggle,
+                "Freeze",
+                false
+                ));
     return layout;
 }
 
 void AudioPluginAudioProcessor::update() {
     playHead = this->getPlayHead();
+    //Set before the delay times so a jump in this update already fades.
+    delayModule.setCrossfadeTime(crossfadeTimeParam->get() * 0.001f);
     float lDelayTime; 
     float rDelayTime; 
     if (!syncToggleParam->get()) {
@@ -246,6 +320,12 @@ void AudioPluginAudioProcessor::update() {
     }
     delayModule.setWetLevel((float)wetLevelParam->get() * 0.01f);    
     delayModule.setFeedbackLevel((float)feedbackLevelParam->get() * 0.01);    
+    delayModule.setDuckThreshold(duckThresholdParam->get());
+    delayModule.setDuckAmount((float)duckAmountParam->get() * 0.01f);
+    delayModule.setDuckAttackTime(duckAttackParam->get() * 0.001f);
+    delayModule.setDuckReleaseTime(duckReleaseParam->get() * 0.001f);
+    delayModule.setFreeze(freezeToggleParam->get());
+    delayModule.setDuckDetector(duckDetectorParam->getIndex() == 0 ? Delay<float>::DuckDetector::peak : Delay<float>::DuckDetector::rms);
 }
 
 //==============================================================================
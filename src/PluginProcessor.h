@@ -15,6 +15,13 @@ namespace ParameterID {
     PARAMETER_ID(syncToggle);
     PARAMETER_ID(lSyncRate);
     PARAMETER_ID(rSyncRate);
+    PARAMETER_ID(crossfadeTime);
+    PARAMETER_ID(duckThreshold);
+    PARAMETER_ID(duckAmount);
+    PARAMETER_ID(duckAttack);
+    PARAMETER_ID(duckRelease);
+    PARAMETER_ID(duckDetector);
+    PARAMETER_ID(freezeToggle);
 }
 //==============================================================================
 class AudioPluginAudioProcessor final : public juce::AudioProcessor,
@@ -73,6 +80,13 @@ private:
     juce::AudioParameterBool* syncToggleParam;
     juce::AudioParameterChoice* lSyncRateParam;
     juce::AudioParameterChoice* rSyncRateParam;
+    juce::AudioParameterFloat* crossfadeTimeParam;
+    juce::AudioParameterFloat* duckThresholdParam;
+    juce::AudioParameterInt* duckAmountParam;
+    juce::AudioParameterFloat* duckAttackParam;
+    juce::AudioParameterFloat* duckReleaseParam;
+    juce::AudioParameterChoice* duckDetectorParam;
+    juce::AudioParameterBool* freezeToggleParam;
     
     //Parameter Tree Setup
     juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();